@@ -0,0 +1,37 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A message used as benchmark input
+typedef struct {
+    uint32_t id;
+    bool rtr;
+    uint8_t dlc;
+    uint8_t data[8];
+} bench_msg_t;
+
+extern const bench_msg_t bench_msgs[];
+extern const uint32_t bench_n_msgs;
+
+uint64_t bench_now_ns(void);
+void bench_report(const char *name, double value, const char *unit);
+
+// Fastest of BENCH_REPEATS runs of fn(iterations), in ns per iteration
+double bench_time_ns(void (*fn)(uint32_t iterations), uint32_t iterations);
+
+// bench_time_ns() of a fixed reference loop, measured once at startup; host timings
+// are also reported in these units so that their limits hold across machines
+extern double bench_ref_ns;
+
+// Individual suites
+void bench_encode(uint32_t iterations);
+void bench_queue(uint32_t iterations);
+void bench_tx(uint32_t iterations);
+void bench_trace(void);
+
+// VCD trace of simulated bus activity
+int bench_tx_trace(const char *path, uint32_t frames);
+
+#endif // BENCH_H
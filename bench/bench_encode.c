@@ -0,0 +1,67 @@
+#include "bench.h"
+#include "custom_can_frame.h"
+
+// ID B used for the fixed extended message set
+#define EXT_ID_B                 (0x15a5aU)
+
+static can_frame_t frame;
+
+static void encode_std(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; i++) {
+        const bench_msg_t *msg = &bench_msgs[i % bench_n_msgs];
+        custom_can_encode_frame(&frame, msg->id, false, msg->rtr, msg->dlc, msg->data);
+    }
+}
+
+// The same messages with 29-bit IDs
+static void encode_ext(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; i++) {
+        const bench_msg_t *msg = &bench_msgs[i % bench_n_msgs];
+        custom_can_encode_frame(&frame, (msg->id << 18U) | (i & 0x3ffffU), true, msg->rtr, msg->dlc, msg->data);
+    }
+}
+
+// Cost of custom_can_encode_frame(): SOF..IFS with CRC and bit stuffing
+void bench_encode(uint32_t iterations)
+{
+    uint64_t bits = 0;
+    uint64_t stuff_bits = 0;
+
+    double ns = bench_time_ns(encode_std, iterations);
+    double ext_ns = bench_time_ns(encode_ext, iterations);
+
+    for (uint32_t i = 0; i < bench_n_msgs; i++) {
+        const bench_msg_t *msg = &bench_msgs[i];
+        custom_can_encode_frame(&frame, msg->id, false, msg->rtr, msg->dlc, msg->data);
+        bits += frame.tx_bits;
+        for (uint32_t j = 0; j < frame.tx_bits; j++) {
+            stuff_bits += frame.stuff_bit[j];
+        }
+    }
+
+    // Output of a fixed extended message set, so SRR/IDE/ID B ordering and CRC regressions are caught
+    uint64_t ext_bits = 0;
+    uint64_t ext_stuff_bits = 0;
+    uint64_t ext_crc_sum = 0;
+    for (uint32_t i = 0; i < bench_n_msgs; i++) {
+        const bench_msg_t *msg = &bench_msgs[i];
+        custom_can_encode_frame(&frame, (msg->id << 18U) | EXT_ID_B, true, msg->rtr, msg->dlc, msg->data);
+        ext_bits += frame.tx_bits;
+        ext_crc_sum += frame.crc_rg;
+        for (uint32_t j = 0; j < frame.tx_bits; j++) {
+            ext_stuff_bits += frame.stuff_bit[j];
+        }
+    }
+
+    bench_report("encode_ns_per_frame", ns, "ns");
+    bench_report("encode_ext_ns_per_frame", ext_ns, "ns");
+    bench_report("encode_ref_per_frame", ns / bench_ref_ns, "ref");
+    bench_report("encode_ext_ref_per_frame", ext_ns / bench_ref_ns, "ref");
+    bench_report("encode_bits_per_frame", (double)bits / bench_n_msgs, "bits");
+    bench_report("encode_stuff_bits_per_frame", (double)stuff_bits / bench_n_msgs, "bits");
+    bench_report("encode_ext_bits_per_frame", (double)ext_bits / bench_n_msgs, "bits");
+    bench_report("encode_ext_stuff_bits_per_frame", (double)ext_stuff_bits / bench_n_msgs, "bits");
+    bench_report("encode_ext_crc_sum", (double)ext_crc_sum, "crc");
+}
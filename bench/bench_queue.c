@@ -0,0 +1,65 @@
+#include <string.h>
+#include "bench.h"
+#include "custom_can_frame.h"
+#include "thycan.h"
+
+// GPIO port handle referenced by GPIOB in the host HAL stand-in
+GPIO_TypeDef sim_gpiob;
+
+static CAN_State state;
+static CAN_Frame frames[CAN_QUEUE_SIZE];
+
+static void load_frame(CAN_Frame *out, const bench_msg_t *msg)
+{
+    static can_frame_t frame;
+
+    custom_can_encode_frame(&frame, msg->id, false, msg->rtr, msg->dlc, msg->data);
+
+    memset(out, 0, sizeof(*out));
+    out->id = msg->id;
+    out->dlc = msg->dlc;
+    memcpy(out->data, msg->data, sizeof(out->data));
+    out->rtr = msg->rtr;
+    memcpy(out->tx_bitstream, frame.tx_bitstream, frame.tx_bits);
+    out->tx_bits = frame.tx_bits;
+}
+
+static void enqueue(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; i++) {
+        thycan_set_frame(&state, &frames[i % CAN_QUEUE_SIZE]);
+    }
+}
+
+// thycan queue: enqueue (including the overwrite-oldest path once full) and
+// process_queue (dequeue + transmit against the simulated bus, counted in ticks)
+void bench_queue(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < CAN_QUEUE_SIZE; i++) {
+        load_frame(&frames[i], &bench_msgs[i % bench_n_msgs]);
+    }
+
+    memset(&state, 0, sizeof(state));
+    thycan_init();
+
+    double ns = bench_time_ns(enqueue, iterations);
+    bench_report("queue_enqueue_ops_per_sec", 1e9 / ns, "ops/s");
+    bench_report("queue_enqueue_ref_per_op", ns / bench_ref_ns, "ref");
+
+    uint64_t ticks = 0;
+    uint32_t failures = 0;
+    for (uint32_t i = 0; i < CAN_QUEUE_SIZE; i++) {
+        thycan_set_frame(&state, &frames[i]);
+    }
+    while (state.count) {
+        can_sim_reset(1U);
+        can_sim.limit = 2U * CAN_MAX_BITS * BIT_TIME;
+        thycan_process_queue(&state);
+        ticks += can_sim.now;
+        if (!state.sent) {
+            failures++;
+        }
+    }
+    bench_report("queue_process_ticks_per_frame", (double)ticks / CAN_QUEUE_SIZE, "ticks");
+    bench_report("queue_process_failures", failures, "frames");
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "nucleo_custom_can.h"
+
+// Golden check of the VCD writer: fixed frames are traced and the sequence of
+// `field` and `stuff` changes is compared against a known-good one. Field
+// changes appear as the field name, stuff rising/falling as + and -.
+
+#define TRACE_VCD_SIZE           (16384U)
+#define TRACE_TOKENS_SIZE        (1024U)
+
+typedef struct {
+    const char *name;
+    uint32_t id;
+    bool extended;
+    bool rtr;
+    uint8_t dlc;
+    uint8_t data[8];
+    const char *fields;
+} trace_golden_t;
+
+// Stuff bits land in ID, RTR, DLC, DATA and CRC; in the extended frame ID A ends in 111,
+// so the stuff bit after SRR and IDE must be labelled IDE, and the all-zero ID B stuffs repeatedly
+static const trace_golden_t goldens[] = {
+    { "std", 0x7f0U, false, false, 1U, { 0x00U },
+      "SOF ID + - RTR + - IDE r0 DLC + - DATA + - CRC CRC_DEL ACK ACK_DEL EOF IFS IDLE" },
+    { "ext", 0x001c0000U, true, false, 1U, { 0xffU },
+      "SOF ID + - SRR IDE + - ID + - + - + - RTR + - r1 r0 DLC + - DATA + - + - CRC + - + - "
+      "CRC_DEL ACK ACK_DEL EOF IFS IDLE" },
+};
+
+static char vcd[TRACE_VCD_SIZE];
+static size_t vcd_len;
+
+static void vcd_write(void *ctx, const char *buf, size_t len)
+{
+    (void)ctx;
+    if (len > sizeof(vcd) - 1U - vcd_len) {
+        len = sizeof(vcd) - 1U - vcd_len;
+    }
+    memcpy(&vcd[vcd_len], buf, len);
+    vcd_len += len;
+    vcd[vcd_len] = '\0';
+}
+
+// Field and stuff changes after the $dumpvars block, i.e. from the first timestamp on
+static void vcd_tokens(char *out, size_t size)
+{
+    const char *line = strchr(vcd, '#');
+    size_t len = 0;
+
+    out[0] = '\0';
+    while (line != NULL && *line) {
+        const char *end = strchr(line, '\n');
+        size_t n = end ? (size_t)(end - line) : strlen(line);
+        const char *token = NULL;
+        size_t token_len = 0;
+
+        if (n == 2U && line[1] == 'b') {
+            token = line[0] == '1' ? "+" : "-";
+            token_len = 1U;
+        }
+        else if (line[0] == 's' && n > 3U && line[n - 2U] == ' ' && line[n - 1U] == 'f') {
+            token = line + 1;
+            token_len = n - 3U;
+        }
+        if (token != NULL && len + token_len + 2U < size) {
+            if (len) {
+                out[len++] = ' ';
+            }
+            memcpy(&out[len], token, token_len);
+            len += token_len;
+            out[len] = '\0';
+        }
+        line = end ? end + 1 : NULL;
+    }
+}
+
+static bool check(const trace_golden_t *golden, const char *how)
+{
+    static char tokens[TRACE_TOKENS_SIZE];
+
+    vcd_tokens(tokens, sizeof(tokens));
+    if (strcmp(tokens, golden->fields) == 0) {
+        return true;
+    }
+    fprintf(stderr, "trace %s (%s) fields:\n  got      %s\n  expected %s\n", golden->name, how, tokens, golden->fields);
+    return false;
+}
+
+// Send the frame through the TX loop on the simulated bus, tracing as it goes
+static bool trace_tx(const trace_golden_t *golden)
+{
+    static can_trace_t trace;
+    can_frame_t *frame = custom_can_get_frame();
+
+    custom_can_encode_frame(frame, golden->id, golden->extended, golden->rtr, golden->dlc, golden->data);
+
+    vcd_len = 0;
+    can_sim_reset(1U);
+    can_sim.limit = 2U * CAN_MAX_BITS * BIT_TIME;
+    can_trace_begin(&trace, vcd_write, NULL, TICK_PS);
+    can_sim_trace(&trace);
+    can_trace_frame(&trace, frame);
+    can_send_frame(0);
+    can_sim_end_frame();
+    can_trace_end(&trace, can_sim.now);
+    can_sim_trace(NULL);
+
+    return check(golden, "tx");
+}
+
+// Replay the events the TX loop would record on target through can_trace_capture()
+static bool trace_capture(const trace_golden_t *golden)
+{
+    static can_trace_t trace;
+    static can_frame_t frame;
+    static can_capture_t capture;
+
+    custom_can_encode_frame(&frame, golden->id, golden->extended, golden->rtr, golden->dlc, golden->data);
+
+    memset(&capture, 0, sizeof(capture));
+    capture.frame = &frame;
+    for (uint32_t i = 0; i + 1U < frame.tx_bits; i++) {
+        can_capture_event(&capture, i * BIT_TIME, CAN_CAPTURE_TX, (uint8_t)i);
+        can_capture_event(&capture, i * BIT_TIME + SAMPLE_POINT_OFFSET, CAN_CAPTURE_SAMPLE, frame.tx_bitstream[i]);
+    }
+
+    vcd_len = 0;
+    can_trace_begin(&trace, vcd_write, NULL, TICK_PS);
+    can_trace_capture(&trace, &capture, BIT_TIME);
+    can_trace_end(&trace, trace.time);
+
+    return check(golden, "capture");
+}
+
+void bench_trace(void)
+{
+    uint32_t failures = 0;
+
+    for (uint32_t i = 0; i < sizeof(goldens) / sizeof(goldens[0]); i++) {
+        failures += !trace_tx(&goldens[i]);
+        failures += !trace_capture(&goldens[i]);
+    }
+    bench_report("trace_golden_failures", failures, "traces");
+}
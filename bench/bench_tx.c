@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include "bench.h"
+#include "nucleo_custom_can.h"
+
+// Competing node used for the arbitration scenario; its lower ID always wins
+#define CONTENDER_ID             (0x100U)
+#define CONTENDER_RETRIES        (3U)
+
+static void load_frame(const bench_msg_t *msg)
+{
+    custom_can_encode_frame(custom_can_get_frame(), msg->id, false, msg->rtr, msg->dlc, msg->data);
+}
+
+// can_send_frame()/send_bits() on an idle bus, frames sent back to back
+static void bench_tx_idle(uint32_t iterations)
+{
+    uint32_t failures = 0;
+
+    can_sim_reset(1U);
+    can_sim.limit = (uint64_t)iterations * 2U * CAN_MAX_BITS * BIT_TIME;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        load_frame(&bench_msgs[i % bench_n_msgs]);
+        if (!can_send_frame(0)) {
+            failures++;
+        }
+        can_sim_end_frame();
+    }
+
+    bench_report("tx_ticks_per_frame", (double)can_sim.now / iterations, "ticks");
+    bench_report("tx_idle_bus_utilization", (double)can_sim.busy_ticks / can_sim.now, "ratio");
+    bench_report("tx_idle_failures", failures, "frames");
+}
+
+// A lower-ID node starts its SOF between our 10th and 11th idle sample, so we
+// hard-sync onto it, lose arbitration and retry once it has finished
+static void bench_tx_contended(uint32_t iterations)
+{
+    static can_frame_t contender;
+    const bench_msg_t *msg = &bench_msgs[0];
+    uint64_t retries = 0;
+    uint64_t busy = 0;
+    uint64_t ticks = 0;
+    uint32_t failures = 0;
+
+    custom_can_encode_frame(&contender, CONTENDER_ID, false, false, msg->dlc, msg->data);
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        can_sim_reset(1U);
+        can_sim.limit = (CONTENDER_RETRIES + 2U) * 2U * CAN_MAX_BITS * BIT_TIME;
+        can_sim_contend(contender.tx_bitstream, contender.tx_bits,
+                        SAMPLE_POINT_OFFSET + 9U * BIT_TIME + BIT_TIME / 2U, BIT_TIME);
+        load_frame(msg);
+        if (!can_send_frame(CONTENDER_RETRIES)) {
+            failures++;
+        }
+        can_sim_end_frame();
+        retries += can_sim.tx_aborts;
+        busy += can_sim.busy_ticks;
+        ticks += can_sim.now;
+    }
+
+    bench_report("tx_contended_retries_per_frame", (double)retries / iterations, "retries");
+    bench_report("tx_contended_ticks_per_frame", (double)ticks / iterations, "ticks");
+    bench_report("tx_contended_bus_utilization", (double)busy / ticks, "ratio");
+    bench_report("tx_contended_failures", failures, "frames");
+}
+
+void bench_tx(uint32_t iterations)
+{
+    bench_tx_idle(iterations);
+    bench_tx_contended(iterations / 10U + 1U);
+}
+
+static void trace_write(void *ctx, const char *buf, size_t len)
+{
+    fwrite(buf, 1U, len, (FILE *)ctx);
+}
+
+// Send `frames` frames back to back, every other one against the contending
+// node, streaming the bus activity to `path` as VCD
+int bench_tx_trace(const char *path, uint32_t frames)
+{
+    static can_trace_t trace;
+    static can_frame_t contender;
+    const bench_msg_t *msg = &bench_msgs[0];
+
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open trace %s\n", path);
+        return 1;
+    }
+
+    custom_can_encode_frame(&contender, CONTENDER_ID, false, false, msg->dlc, msg->data);
+
+    can_sim_reset(1U);
+    can_trace_begin(&trace, trace_write, f, TICK_PS);
+    can_sim_trace(&trace);
+
+    for (uint32_t i = 0; i < frames; i++) {
+        can_sim.limit = can_sim.now + (CONTENDER_RETRIES + 2U) * 2U * CAN_MAX_BITS * BIT_TIME;
+        if (i & 1U) {
+            can_sim_contend(contender.tx_bitstream, contender.tx_bits,
+                            can_sim.now + SAMPLE_POINT_OFFSET + 9U * BIT_TIME + BIT_TIME / 2U, BIT_TIME);
+        }
+        load_frame(&bench_msgs[i % bench_n_msgs]);
+        can_trace_frame(&trace, custom_can_get_frame());
+        can_send_frame(CONTENDER_RETRIES);
+        can_sim_end_frame();
+    }
+
+    can_trace_end(&trace, can_sim.now);
+    can_sim_trace(NULL);
+    return fclose(f) ? 1 : 0;
+}
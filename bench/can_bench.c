@@ -0,0 +1,218 @@
+// Host benchmark for the CAN encoder, the thycan queue and the bit-banged TX loop.
+//
+// Results are written to stdout as a single JSON object. With -b, each metric is
+// also checked against a baseline file and the exit status is non-zero if any
+// check fails. With -t, a VCD trace of simulated TX activity is written as well.
+//
+// Host timings are the fastest of BENCH_REPEATS runs, and are also reported
+// relative to a reference loop so that baselines carry across machines.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+#define BENCH_MAX_RESULTS          (32U)
+#define BENCH_DEFAULT_ITERATIONS   (100000U)
+#define BENCH_DEFAULT_TRACE_FRAMES (10U)
+#define BENCH_REPEATS              (5U)
+
+typedef struct {
+    const char *name;
+    double value;
+    const char *unit;
+} bench_result_t;
+
+static bench_result_t results[BENCH_MAX_RESULTS];
+static uint32_t n_results;
+
+const bench_msg_t bench_msgs[] = {
+    { 0x123U, false, 8U, { 0x01U, 0x02U, 0x03U, 0x04U, 0x05U, 0x06U, 0x07U, 0x08U } },
+    { 0x7ffU, true,  0,  { 0 } },
+    { 0x555U, false, 3U, { 0xaaU, 0x55U, 0xaaU } },
+    { 0x0f0U, false, 8U, { 0xffU, 0x00U, 0xffU, 0x00U, 0xffU, 0x00U, 0xffU, 0x00U } },
+    { 0x001U, false, 1U, { 0x80U } },
+};
+const uint32_t bench_n_msgs = sizeof(bench_msgs) / sizeof(bench_msgs[0]);
+
+double bench_ref_ns;
+
+// Keeps the reference loop's result live
+static volatile uint32_t ref_sink;
+
+uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+void bench_report(const char *name, double value, const char *unit)
+{
+    if (n_results < BENCH_MAX_RESULTS) {
+        results[n_results].name = name;
+        results[n_results].value = value;
+        results[n_results].unit = unit;
+        n_results++;
+    }
+}
+
+double bench_time_ns(void (*fn)(uint32_t iterations), uint32_t iterations)
+{
+    uint64_t best = UINT64_MAX;
+
+    for (uint32_t i = 0; i < BENCH_REPEATS; i++) {
+        uint64_t start = bench_now_ns();
+        fn(iterations);
+        uint64_t elapsed = bench_now_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return (double)best / iterations;
+}
+
+// Reference workload: a bit-serial CRC-15 over 8 bytes, close in kind to the encoder's inner loop
+static void ref_loop(uint32_t iterations)
+{
+    uint32_t crc = 0;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t word = i * 0x9e3779b9U;
+        for (uint32_t j = 0; j < 64U; j++) {
+            uint32_t crc_nxt = ((word >> (j & 31U)) ^ (crc >> 14U)) & 1U;
+            crc = (crc << 1U) & 0x7fffU;
+            if (crc_nxt) {
+                crc ^= 0x4599U;
+            }
+        }
+    }
+    ref_sink = crc;
+}
+
+static const bench_result_t *find_result(const char *name)
+{
+    for (uint32_t i = 0; i < n_results; i++) {
+        if (strcmp(results[i].name, name) == 0) {
+            return &results[i];
+        }
+    }
+    return NULL;
+}
+
+// Baseline lines are "<metric> <op> <limit>" with op one of <=, >=, ==;
+// blank lines and lines starting with '#' are ignored
+static int check_baseline(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open baseline %s\n", path);
+        return 1;
+    }
+
+    char line[256];
+    char name[128];
+    char op[3];
+    double limit;
+    uint32_t lineno = 0;
+    int failed = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (sscanf(line, "%127s %2s %lf", name, op, &limit) != 3) {
+            fprintf(stderr, "%s:%u: malformed line\n", path, lineno);
+            failed = 1;
+            continue;
+        }
+        const bench_result_t *r = find_result(name);
+        if (r == NULL) {
+            fprintf(stderr, "%s:%u: unknown metric %s\n", path, lineno, name);
+            failed = 1;
+            continue;
+        }
+
+        bool ok;
+        if (strcmp(op, "<=") == 0) {
+            ok = r->value <= limit;
+        } else if (strcmp(op, ">=") == 0) {
+            ok = r->value >= limit;
+        } else if (strcmp(op, "==") == 0) {
+            ok = r->value == limit;
+        } else {
+            fprintf(stderr, "%s:%u: unknown operator %s\n", path, lineno, op);
+            failed = 1;
+            continue;
+        }
+        if (!ok) {
+            fprintf(stderr, "REGRESSION %s = %g %s, expected %s %g\n", name, r->value, r->unit, op, limit);
+            failed = 1;
+        }
+    }
+    fclose(f);
+    return failed;
+}
+
+static void print_results(void)
+{
+    printf("{\n");
+    for (uint32_t i = 0; i < n_results; i++) {
+        printf("  \"%s\": { \"value\": %.6g, \"unit\": \"%s\" }%s\n",
+               results[i].name, results[i].value, results[i].unit, (i + 1U < n_results) ? "," : "");
+    }
+    printf("}\n");
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n iterations] [-b baseline] [-t trace.vcd [-f frames]]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = BENCH_DEFAULT_ITERATIONS;
+    const char *baseline = NULL;
+    const char *trace = NULL;
+    uint32_t trace_frames = BENCH_DEFAULT_TRACE_FRAMES;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            trace = argv[++i];
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            trace_frames = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (iterations == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    bench_ref_ns = bench_time_ns(ref_loop, iterations);
+    bench_report("ref_ns", bench_ref_ns, "ns");
+
+    bench_encode(iterations);
+    bench_queue(iterations);
+    bench_tx(iterations / 100U + 1U);
+    bench_trace();
+
+    print_results();
+
+    if (trace != NULL && bench_tx_trace(trace, trace_frames)) {
+        return 1;
+    }
+
+    if (baseline != NULL) {
+        return check_baseline(baseline);
+    }
+    return 0;
+}
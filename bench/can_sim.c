@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "can_sim.h"
+
+can_sim_t can_sim;
+
+void can_sim_reset(uint32_t tick_cost)
+{
+    memset(&can_sim, 0, sizeof(can_sim));
+    can_sim.tick_cost = tick_cost;
+    can_sim.tx = 1U;
+}
+
+void can_sim_contend(const uint8_t *bits, uint32_t nbits, uint64_t start, uint32_t bit_time)
+{
+    can_sim.other_bits = bits;
+    can_sim.other_nbits = nbits;
+    can_sim.other_start = start;
+    can_sim.other_bit_time = bit_time;
+}
+
+// Called by the harness once the node under test has finished a frame, since the
+// TX loop leaves the last (recessive) bit on the pin rather than releasing the bus
+void can_sim_end_frame(void)
+{
+    can_sim.tx = 1U;
+    can_sim.tx_active = false;
+    if (can_sim.trace) {
+        can_trace_idle(can_sim.trace, can_sim.now);
+    }
+}
+
+// Write TX, RX, sample strobes and field annotations of the node under test to
+// `trace`; the frame being sent must also be passed to can_trace_frame()
+void can_sim_trace(can_trace_t *trace)
+{
+    can_sim.trace = trace;
+    can_sim.bus = 1U;
+}
+
+static bool other_active(uint64_t t, uint8_t *bit)
+{
+    if (can_sim.other_bits == NULL || t < can_sim.other_start) {
+        return false;
+    }
+    uint64_t index = (t - can_sim.other_start) / can_sim.other_bit_time;
+    if (index >= can_sim.other_nbits) {
+        return false;
+    }
+    *bit = can_sim.other_bits[index];
+    return true;
+}
+
+uint32_t can_sim_clock(void)
+{
+    uint8_t bit;
+    if (can_sim.tx_active || other_active(can_sim.now, &bit)) {
+        can_sim.busy_ticks += can_sim.tick_cost;
+    }
+    can_sim.now += can_sim.tick_cost;
+    if (can_sim.trace) {
+        uint8_t bus = can_sim_rx();
+        if (bus != can_sim.bus) {
+            can_trace_rx(can_sim.trace, can_sim.now, bus);
+            can_sim.bus = bus;
+        }
+    }
+    if (can_sim.limit && can_sim.now > can_sim.limit) {
+        fprintf(stderr, "can_sim: no progress after %llu ticks\n", (unsigned long long)can_sim.now);
+        exit(2);
+    }
+    return (uint32_t)(can_sim.now - can_sim.clock_base);
+}
+
+void can_sim_reset_clock(uint32_t t)
+{
+    can_sim.clock_base = can_sim.now - t;
+}
+
+uint8_t can_sim_rx(void)
+{
+    uint8_t bit = 1U;
+    other_active(can_sim.now, &bit);
+    return can_sim.tx & bit;
+}
+
+void can_sim_set_tx(uint8_t bit)
+{
+    can_sim.tx = bit ? 1U : 0;
+    can_sim.tx_active = true;
+}
+
+void can_sim_release_tx(void)
+{
+    can_sim.tx = 1U;
+    can_sim.tx_active = false;
+    can_sim.tx_aborts++;
+    if (can_sim.trace) {
+        can_trace_idle(can_sim.trace, can_sim.now);
+    }
+}
+
+void can_sim_trace_tx_bit(uint32_t index)
+{
+    if (can_sim.trace) {
+        can_trace_tx_bit(can_sim.trace, can_sim.now, index);
+    }
+}
+
+void can_sim_trace_sample(uint8_t rx)
+{
+    if (can_sim.trace) {
+        can_trace_sample(can_sim.trace, can_sim.now, rx);
+    }
+}
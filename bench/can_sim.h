@@ -0,0 +1,52 @@
+#ifndef CAN_SIM_H
+#define CAN_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "can_trace.h"
+
+// Simulated clock and CAN bus for host builds.
+//
+// Time advances only when the code under test reads the clock: every read costs
+// `tick_cost` ticks, which stands in for one pass of a busy-wait loop on target.
+// The bus is a wired-AND of the node under test and at most one competing node,
+// which replays a fixed bitstream from `other_start` and never backs off.
+typedef struct {
+    uint64_t now;               // Absolute simulated time in ticks
+    uint64_t clock_base;        // Absolute time at which the node's counter reads 0
+    uint64_t limit;             // Abort the run if `now` passes this (0 = no limit)
+    uint32_t tick_cost;         // Ticks consumed by every clock read
+
+    uint8_t tx;                 // Level driven by the node under test (1 = recessive)
+    bool tx_active;             // True while the node under test is driving a frame
+
+    const uint8_t *other_bits;  // Competing node's bitstream (NULL if none)
+    uint32_t other_nbits;       // Number of bits in `other_bits`
+    uint64_t other_start;       // Absolute time of the competing node's first bit
+    uint32_t other_bit_time;    // Competing node's bit time in ticks
+
+    can_trace_t *trace;         // VCD sink (NULL if not tracing)
+    uint8_t bus;                // Bus level last written to `trace`
+
+    // Statistics
+    uint64_t busy_ticks;        // Ticks during which any node was driving a frame
+    uint32_t tx_aborts;         // Times the node under test released the bus mid-frame
+} can_sim_t;
+
+extern can_sim_t can_sim;
+
+void can_sim_reset(uint32_t tick_cost);
+void can_sim_contend(const uint8_t *bits, uint32_t nbits, uint64_t start, uint32_t bit_time);
+void can_sim_end_frame(void);
+void can_sim_trace(can_trace_t *trace);
+
+// Hardware hooks, mapped onto GET_CLOCK() & co. by the port headers
+uint32_t can_sim_clock(void);
+void can_sim_reset_clock(uint32_t t);
+uint8_t can_sim_rx(void);
+void can_sim_set_tx(uint8_t bit);
+void can_sim_release_tx(void);
+void can_sim_trace_tx_bit(uint32_t index);
+void can_sim_trace_sample(uint8_t rx);
+
+#endif // CAN_SIM_H
@@ -0,0 +1,63 @@
+#ifndef STM32F4XX_HAL_H
+#define STM32F4XX_HAL_H
+
+// Host stand-in for the STM32 HAL: just enough for thycan.c, backed by can_sim
+
+#include <stdint.h>
+#include "can_sim.h"
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct {
+    int unused;
+} GPIO_TypeDef;
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+extern GPIO_TypeDef sim_gpiob;
+
+#define GPIOB                       (&sim_gpiob)
+#define GPIO_PIN_8                  ((uint16_t)0x0100U)
+#define GPIO_PIN_9                  ((uint16_t)0x0200U)
+#define GPIO_MODE_INPUT             (0x00000000U)
+#define GPIO_MODE_OUTPUT_PP         (0x00000001U)
+#define GPIO_NOPULL                 (0x00000000U)
+#define GPIO_SPEED_FREQ_VERY_HIGH   (0x00000003U)
+
+#define __HAL_RCC_GPIOB_CLK_ENABLE()    ((void)0)
+
+static inline void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init)
+{
+    (void)port;
+    (void)init;
+}
+
+static inline uint32_t HAL_GetTick(void)
+{
+    return can_sim_clock();
+}
+
+static inline void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state)
+{
+    (void)port;
+    (void)pin;
+    can_sim_set_tx(state == GPIO_PIN_SET);
+}
+
+static inline GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *port, uint16_t pin)
+{
+    (void)port;
+    (void)pin;
+    return can_sim_rx() ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+#endif // STM32F4XX_HAL_H
@@ -0,0 +1,6 @@
+#ifndef STM32F4XX_HAL_GPIO_H
+#define STM32F4XX_HAL_GPIO_H
+
+#include "stm32f4xx_hal.h"
+
+#endif // STM32F4XX_HAL_GPIO_H
@@ -0,0 +1,311 @@
+#include <string.h>
+#include "can_trace.h"
+
+// VCD identifier codes for each signal
+#define ID_TX       "t"
+#define ID_RX       "r"
+#define ID_SAMPLE   "s"
+#define ID_STUFF    "b"
+#define ID_FIELD    "f"
+
+static const char *const field_names[] = {
+    [CAN_FIELD_IDLE]    = "IDLE",
+    [CAN_FIELD_SOF]     = "SOF",
+    [CAN_FIELD_ID]      = "ID",
+    [CAN_FIELD_SRR]     = "SRR",
+    [CAN_FIELD_RTR]     = "RTR",
+    [CAN_FIELD_IDE]     = "IDE",
+    [CAN_FIELD_R1]      = "r1",
+    [CAN_FIELD_R0]      = "r0",
+    [CAN_FIELD_DLC]     = "DLC",
+    [CAN_FIELD_DATA]    = "DATA",
+    [CAN_FIELD_CRC]     = "CRC",
+    [CAN_FIELD_CRC_DEL] = "CRC_DEL",
+    [CAN_FIELD_ACK]     = "ACK",
+    [CAN_FIELD_ACK_DEL] = "ACK_DEL",
+    [CAN_FIELD_EOF]     = "EOF",
+    [CAN_FIELD_IFS]     = "IFS",
+};
+
+static void flush(can_trace_t *trace)
+{
+    if (trace->len) {
+        trace->write(trace->ctx, trace->buf, trace->len);
+        trace->len = 0;
+    }
+}
+
+static void put(can_trace_t *trace, const char *s)
+{
+    size_t n = strlen(s);
+    while (n) {
+        size_t space = CAN_TRACE_BUF_SIZE - trace->len;
+        size_t chunk = n < space ? n : space;
+        memcpy(&trace->buf[trace->len], s, chunk);
+        trace->len += chunk;
+        s += chunk;
+        n -= chunk;
+        if (trace->len == CAN_TRACE_BUF_SIZE) {
+            flush(trace);
+        }
+    }
+}
+
+static void put_u64(can_trace_t *trace, uint64_t value)
+{
+    char digits[21];
+    uint32_t i = sizeof(digits) - 1U;
+
+    digits[i] = '\0';
+    do {
+        digits[--i] = (char)('0' + (value % 10U));
+        value /= 10U;
+    } while (value);
+    put(trace, &digits[i]);
+}
+
+static void put_timestamp(can_trace_t *trace, uint64_t time)
+{
+    put(trace, "#");
+    put_u64(trace, time * trace->ps_per_tick);
+    put(trace, "\n");
+    trace->time = time;
+    trace->time_valid = true;
+}
+
+static void put_bit(can_trace_t *trace, uint8_t bit, const char *id)
+{
+    put(trace, bit ? "1" : "0");
+    put(trace, id);
+    put(trace, "\n");
+}
+
+static void put_field(can_trace_t *trace, can_field_t field)
+{
+    put(trace, "s");
+    put(trace, field_names[field]);
+    put(trace, " " ID_FIELD "\n");
+}
+
+// Move the trace to `time`, first lowering a sample strobe that is due; times
+// earlier than the last timestamp are clamped, since VCD cannot go backwards
+static void advance(can_trace_t *trace, uint64_t time)
+{
+    if (trace->sample_pending && time >= trace->sample_clear) {
+        if (trace->time != trace->sample_clear) {
+            put_timestamp(trace, trace->sample_clear);
+        }
+        put_bit(trace, 0, ID_SAMPLE);
+        trace->sample_pending = false;
+    }
+    if (!trace->time_valid || time > trace->time) {
+        put_timestamp(trace, time);
+    }
+}
+
+void can_trace_begin(can_trace_t *trace, can_trace_write_t write, void *ctx, uint32_t ps_per_tick)
+{
+    memset(trace, 0, sizeof(*trace));
+    trace->write = write;
+    trace->ctx = ctx;
+    trace->ps_per_tick = ps_per_tick;
+    trace->tx = 1U;
+    trace->rx = 1U;
+    trace->field = CAN_FIELD_IDLE;
+
+    put(trace,
+        "$version custom CAN trace $end\n"
+        "$timescale 1ps $end\n"
+        "$scope module can $end\n"
+        "$var wire 1 " ID_TX " tx $end\n"
+        "$var wire 1 " ID_RX " rx $end\n"
+        "$var wire 1 " ID_SAMPLE " sample $end\n"
+        "$var wire 1 " ID_STUFF " stuff $end\n"
+        "$var string 1 " ID_FIELD " field $end\n"
+        "$upscope $end\n"
+        "$enddefinitions $end\n"
+        "$dumpvars\n"
+        "1" ID_TX "\n"
+        "1" ID_RX "\n"
+        "0" ID_SAMPLE "\n"
+        "0" ID_STUFF "\n");
+    put_field(trace, CAN_FIELD_IDLE);
+    put(trace, "$end\n");
+}
+
+void can_trace_end(can_trace_t *trace, uint64_t time)
+{
+    advance(trace, time);
+    flush(trace);
+}
+
+void can_trace_frame(can_trace_t *trace, const can_frame_t *frame)
+{
+    uint32_t rtr_bit = 0;
+    uint32_t arbitration_bits = 0;
+    uint32_t control_bits = 0;
+
+    trace->frame = frame;
+
+    // The RTR bit is the last non-stuff bit of the arbitration field
+    for (uint32_t i = 1U; i <= frame->last_arbitration_bit; i++) {
+        if (!frame->stuff_bit[i]) {
+            rtr_bit = i;
+        }
+    }
+
+    for (uint32_t i = 0; i < frame->tx_bits; i++) {
+        can_field_t field;
+
+        if (i == 0) {
+            field = CAN_FIELD_SOF;
+        }
+        else if (frame->stuff_bit[i]) {
+            // A stuff bit belongs to the field of the bit it follows
+            field = (can_field_t)trace->frame_field[i - 1U];
+        }
+        else if (i <= frame->last_arbitration_bit) {
+            // {ID A, RTR} or {ID A, SRR, IDE, ID B, RTR}
+            arbitration_bits++;
+            if (i == rtr_bit) {
+                field = CAN_FIELD_RTR;
+            }
+            else if (frame->extended && arbitration_bits == 12U) {
+                field = CAN_FIELD_SRR;
+            }
+            else if (frame->extended && arbitration_bits == 13U) {
+                field = CAN_FIELD_IDE;
+            }
+            else {
+                field = CAN_FIELD_ID;
+            }
+        }
+        else if (i <= frame->last_dlc_bit) {
+            // {IDE, r0, DLC} or {r1, r0, DLC}
+            control_bits++;
+            if (control_bits == 1U) {
+                field = frame->extended ? CAN_FIELD_R1 : CAN_FIELD_IDE;
+            }
+            else {
+                field = (control_bits == 2U) ? CAN_FIELD_R0 : CAN_FIELD_DLC;
+            }
+        }
+        else if (i <= frame->last_data_bit) {
+            field = CAN_FIELD_DATA;
+        }
+        else if (i <= frame->last_crc_bit) {
+            field = CAN_FIELD_CRC;
+        }
+        // Stuffing ends with the CRC field so the remaining fields are at fixed offsets
+        else if (i == frame->last_crc_bit + 1U) {
+            field = CAN_FIELD_CRC_DEL;
+        }
+        else if (i == frame->last_crc_bit + 2U) {
+            field = CAN_FIELD_ACK;
+        }
+        else if (i == frame->last_crc_bit + 3U) {
+            field = CAN_FIELD_ACK_DEL;
+        }
+        else if (i <= frame->last_eof_bit) {
+            field = CAN_FIELD_EOF;
+        }
+        else {
+            field = CAN_FIELD_IFS;
+        }
+        trace->frame_field[i] = (uint8_t)field;
+    }
+}
+
+void can_trace_tx_bit(can_trace_t *trace, uint64_t time, uint32_t index)
+{
+    const can_frame_t *frame = trace->frame;
+    uint8_t tx = frame->tx_bitstream[index];
+    bool stuff = frame->stuff_bit[index];
+    can_field_t field = (can_field_t)trace->frame_field[index];
+
+    advance(trace, time);
+    if (tx != trace->tx) {
+        put_bit(trace, tx, ID_TX);
+        trace->tx = tx;
+    }
+    if (stuff != trace->stuff) {
+        put_bit(trace, stuff, ID_STUFF);
+        trace->stuff = stuff;
+    }
+    if (field != trace->field) {
+        put_field(trace, field);
+        trace->field = field;
+    }
+}
+
+void can_trace_rx(can_trace_t *trace, uint64_t time, uint8_t rx)
+{
+    if (rx != trace->rx) {
+        advance(trace, time);
+        put_bit(trace, rx, ID_RX);
+        trace->rx = rx;
+    }
+}
+
+void can_trace_sample(can_trace_t *trace, uint64_t time, uint8_t rx)
+{
+    can_trace_rx(trace, time, rx);
+    advance(trace, time);
+    if (!trace->sample_pending) {
+        put_bit(trace, 1U, ID_SAMPLE);
+        trace->sample_pending = true;
+        trace->sample_clear = trace->time + 1U;
+    }
+}
+
+void can_trace_idle(can_trace_t *trace, uint64_t time)
+{
+    advance(trace, time);
+    if (trace->tx != 1U) {
+        put_bit(trace, 1U, ID_TX);
+        trace->tx = 1U;
+    }
+    if (trace->stuff) {
+        put_bit(trace, 0, ID_STUFF);
+        trace->stuff = false;
+    }
+    if (trace->field != CAN_FIELD_IDLE) {
+        put_field(trace, CAN_FIELD_IDLE);
+        trace->field = CAN_FIELD_IDLE;
+    }
+}
+
+void can_trace_capture(can_trace_t *trace, const can_capture_t *capture, uint32_t bit_time)
+{
+    uint32_t n = capture->n_events < CAN_CAPTURE_MAX_EVENTS ? capture->n_events : CAN_CAPTURE_MAX_EVENTS;
+    uint32_t first = capture->n_events - n;
+    uint64_t base = 0;
+    uint64_t time = 0;
+    uint32_t prev = 0;
+
+    if (capture->frame == NULL) {
+        // Nothing has been sent yet
+        return;
+    }
+    can_trace_frame(trace, capture->frame);
+
+    for (uint32_t k = 0; k < n; k++) {
+        const can_capture_event_t *event = &capture->events[(first + k) % CAN_CAPTURE_MAX_EVENTS];
+
+        // The TX loop resets the clock when it hard-syncs to a SOF; the reset happens
+        // within a bit of the previous event, so treat the counter as continuing from there
+        if (k && event->time < prev) {
+            base = time;
+        }
+        prev = event->time;
+        time = base + event->time;
+
+        if (event->kind == CAN_CAPTURE_TX) {
+            can_trace_tx_bit(trace, time, event->value);
+        }
+        else {
+            can_trace_sample(trace, time, event->value);
+        }
+    }
+    can_trace_idle(trace, time + bit_time);
+}
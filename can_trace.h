@@ -0,0 +1,105 @@
+#ifndef CAN_TRACE_H
+#define CAN_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "custom_can_frame.h"
+
+// Value Change Dump (VCD) trace of CAN bus activity, viewable in GTKWave.
+//
+// Signals: tx (driven by this node), rx (bus level), sample (strobe at each
+// sample point), stuff (high while a stuff bit is driven) and field (name of
+// the frame field being driven, as a VCD string).
+//
+// Output is streamed through a small buffer to a caller-supplied write
+// function, so trace length is not limited by memory.
+
+#define CAN_TRACE_BUF_SIZE                  (256U)
+#define CAN_CAPTURE_MAX_EVENTS              (512U)
+
+typedef enum {
+    CAN_FIELD_IDLE = 0,
+    CAN_FIELD_SOF,
+    CAN_FIELD_ID,
+    CAN_FIELD_SRR,
+    CAN_FIELD_RTR,
+    CAN_FIELD_IDE,
+    CAN_FIELD_R1,
+    CAN_FIELD_R0,
+    CAN_FIELD_DLC,
+    CAN_FIELD_DATA,
+    CAN_FIELD_CRC,
+    CAN_FIELD_CRC_DEL,
+    CAN_FIELD_ACK,
+    CAN_FIELD_ACK_DEL,
+    CAN_FIELD_EOF,
+    CAN_FIELD_IFS,
+} can_field_t;
+
+typedef void (*can_trace_write_t)(void *ctx, const char *buf, size_t len);
+
+typedef struct {
+    can_trace_write_t write;                ///< Sink for VCD text
+    void *ctx;                              ///< Passed to `write`
+    uint32_t ps_per_tick;                   ///< Length of one clock tick in picoseconds
+
+    char buf[CAN_TRACE_BUF_SIZE];           ///< Pending output
+    size_t len;                             ///< Bytes pending in `buf`
+
+    uint64_t time;                          ///< Time of the last emitted timestamp (ticks)
+    bool time_valid;                        ///< True once a timestamp has been emitted
+    uint64_t sample_clear;                  ///< Time at which the sample strobe returns low
+    bool sample_pending;                    ///< True while the sample strobe is high
+
+    // Last emitted signal values, so only changes are written
+    uint8_t tx;
+    uint8_t rx;
+    bool stuff;
+    can_field_t field;
+
+    // Field of each bit of the frame being traced (see can_trace_frame())
+    const can_frame_t *frame;
+    uint8_t frame_field[CAN_MAX_BITS];
+} can_trace_t;
+
+// Kind of a captured event
+#define CAN_CAPTURE_TX                      (0U)    ///< Bit `value` of the frame was driven
+#define CAN_CAPTURE_SAMPLE                  (1U)    ///< RX sampled as `value`
+
+typedef struct {
+    uint32_t time;                          ///< Clock counter when the event happened
+    uint8_t kind;                           ///< CAN_CAPTURE_TX or CAN_CAPTURE_SAMPLE
+    uint8_t value;                          ///< Bit index (TX) or RX level (SAMPLE)
+} can_capture_event_t;
+
+// On-target capture: a ring of the most recent events, cheap enough to record from the TX loop
+typedef struct {
+    can_capture_event_t events[CAN_CAPTURE_MAX_EVENTS];
+    uint32_t n_events;                      ///< Total events recorded (may exceed the ring size)
+    const can_frame_t *frame;               ///< Frame being sent, which TX events index into
+} can_capture_t;
+
+static inline void can_capture_event(can_capture_t *capture, uint32_t time, uint8_t kind, uint8_t value)
+{
+    can_capture_event_t *event = &capture->events[capture->n_events++ % CAN_CAPTURE_MAX_EVENTS];
+    event->time = time;
+    event->kind = kind;
+    event->value = value;
+}
+
+void can_trace_begin(can_trace_t *trace, can_trace_write_t write, void *ctx, uint32_t ps_per_tick);
+void can_trace_end(can_trace_t *trace, uint64_t time);
+
+// Set the frame whose bits subsequent can_trace_tx_bit() calls refer to
+void can_trace_frame(can_trace_t *trace, const can_frame_t *frame);
+
+void can_trace_tx_bit(can_trace_t *trace, uint64_t time, uint32_t index);
+void can_trace_rx(can_trace_t *trace, uint64_t time, uint8_t rx);
+void can_trace_sample(can_trace_t *trace, uint64_t time, uint8_t rx);
+void can_trace_idle(can_trace_t *trace, uint64_t time);
+
+// Replay a capture buffer against the frame it was recorded for
+void can_trace_capture(can_trace_t *trace, const can_capture_t *capture, uint32_t bit_time);
+
+#endif // CAN_TRACE_H
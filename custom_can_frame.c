@@ -0,0 +1,192 @@
+#include "custom_can_frame.h"
+
+static void add_bit(uint8_t bit, can_frame_t *frame);
+
+void custom_can_encode_frame(can_frame_t *frame, uint32_t id, bool extended, bool rtr, uint32_t dlc, const uint8_t *data)
+{
+    uint8_t len = rtr ? 0 : (dlc >= 8U ? 8U : dlc);
+    uint32_t id_a = extended ? (id >> 18U) & 0x7ffU : id & 0x7ffU;
+    uint32_t id_b = id & 0x3ffffU;
+
+    frame->tx_bits = 0;
+    frame->crc_rg = 0;
+    frame->stuffing = true;
+    frame->crcing = true;
+    frame->dominant_bits = 0;
+    frame->recessive_bits = 0;
+    frame->extended = extended;
+
+    for (uint32_t i = 0; i < CAN_MAX_BITS; i++) {
+        frame->tx_bitstream[i] = 1U;
+    }
+
+    // ID field is:
+    // {SOF, ID A, RTR, IDE = 0, r0} [Standard]
+    // {SOF, ID A, SRR = 1, IDE = 1, ID B, RTR, r1, r0} [Extended]
+
+    // SOF
+    add_bit(0, frame);
+
+    // ID A
+    id_a <<= 21U;
+    for (uint32_t i = 0; i < 11U; i++) {
+        if (id_a & 0x80000000U) {
+            add_bit(1U, frame);
+        }
+        else {
+            add_bit(0, frame);
+        }
+        id_a <<= 1U;
+    }
+
+    if (extended) {
+        // SRR
+        add_bit(1U, frame);
+        // IDE
+        add_bit(1U, frame);
+
+        // ID B
+        id_b <<= 14U;
+        for (uint32_t i = 0; i < 18U; i++) {
+            if (id_b & 0x80000000U) {
+                add_bit(1U, frame);
+            }
+            else {
+                add_bit(0, frame);
+            }
+            id_b <<= 1U;
+        }
+    }
+
+    // RTR
+    if (rtr) {
+        add_bit(1U, frame);
+    }
+    else {
+        add_bit(0, frame);
+    }
+
+    // The last bit of the arbitration field is the RTR bit for both basic and extended frames
+    frame->last_arbitration_bit = frame->tx_bits - 1U;
+
+    // IDE = 0 (standard) or r1 (extended)
+    add_bit(0, frame);
+
+    // r0
+    add_bit(0, frame);
+
+    // DLC (length)
+    dlc <<= 28U;
+    for (uint32_t i = 0; i < 4U; i++) {
+        if (dlc & 0x80000000U) {
+            add_bit(1U, frame);
+        } else {
+            add_bit(0, frame);
+        }
+        dlc <<= 1U;
+    }
+    frame->last_dlc_bit = frame->tx_bits - 1U;
+
+    // Data
+    for (uint32_t i = 0; i < len; i ++) {
+        uint8_t byte = data[i];
+        for (uint32_t j = 0; j < 8; j++) {
+            if (byte & 0x80U) {
+                add_bit(1U, frame);
+            }
+            else {
+                add_bit(0, frame);
+            }
+            byte <<= 1U;
+        }
+    }
+    // If the length is 0 then the last data bit is equal to the last DLC bit
+    frame->last_data_bit = frame->tx_bits - 1U;
+
+    // CRC
+    frame->crcing = false;
+    uint32_t crc_rg = frame->crc_rg << 17U;
+    for (uint32_t i = 0; i < 15U; i++) {
+        if (crc_rg & 0x80000000U) {
+            add_bit(1U, frame);
+        } else {
+            add_bit(0, frame);
+        }
+        crc_rg <<= 1U;
+    }
+    frame->last_crc_bit = frame->tx_bits - 1U;
+
+    // Bit stuffing is disabled at the end of the CRC field
+    frame->stuffing = false;
+
+    // CRC delimiter
+    add_bit(1U, frame);
+    // ACK slot
+    add_bit(1U, frame);
+    // ACK delimiter
+    add_bit(1U, frame);
+    // EOF
+    add_bit(1U, frame);
+    add_bit(1U, frame);
+    add_bit(1U, frame);
+    add_bit(1U, frame);
+    add_bit(1U, frame);
+    add_bit(1U, frame);
+    add_bit(1U, frame);
+    frame->last_eof_bit = frame->tx_bits - 1U;
+
+    // IFS
+    add_bit(1U, frame);
+    add_bit(1U, frame);
+    add_bit(1U, frame);
+
+    // Set up the matching masks for this CAN frame
+    frame->tx_arbitration_bits = frame->last_arbitration_bit + 1U;
+
+    frame->frame_set = true;
+}
+
+static void add_raw_bit(uint8_t bit, bool stuff, can_frame_t *frame)
+{
+    // Record the status of the stuff bit for display purposes
+    frame->stuff_bit[frame->tx_bits] = stuff;
+    frame->tx_bitstream[frame->tx_bits++] = bit;
+}
+
+static void do_crc(uint8_t bitval, can_frame_t *frame)
+{
+    uint32_t bit_14 = (frame->crc_rg & (1U << 14U)) >> 14U;
+    uint32_t crc_nxt = bitval ^ bit_14;
+    frame->crc_rg <<= 1U;
+    frame->crc_rg &= 0x7fffU;
+    if (crc_nxt) {
+        frame->crc_rg ^= 0x4599U;
+    }
+}
+
+static void add_bit(uint8_t bit, can_frame_t *frame)
+{
+    if (frame->crcing) {
+        do_crc(bit, frame);
+    }
+    add_raw_bit(bit, false, frame);
+    if (bit) {
+        frame->recessive_bits++;
+        frame->dominant_bits = 0;
+    } else {
+        frame->dominant_bits++;
+        frame->recessive_bits = 0;
+    }
+    if (frame->stuffing) {
+        if (frame->dominant_bits >= 5U) {
+            add_raw_bit(1U, true, frame);
+            frame->dominant_bits = 0;
+            frame->recessive_bits = 1U;
+        }
+        if (frame->recessive_bits >= 5U) {
+            add_raw_bit(0, true, frame);
+            frame->dominant_bits = 1U;
+            frame->recessive_bits = 0;
+        }
+    }
+}
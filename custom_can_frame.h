@@ -0,0 +1,38 @@
+#ifndef CUSTOM_CAN_FRAME_H
+#define CUSTOM_CAN_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Worst case is an extended frame with 8 data bytes: 118 stuffable bits, up to 29 stuff bits,
+// then CRC delimiter, ACK, ACK delimiter, EOF and IFS
+#define CAN_MAX_BITS                        (160U)
+
+typedef struct {
+    uint8_t tx_bitstream[CAN_MAX_BITS];     ///< The bitstream of the CAN frame
+    bool stuff_bit[CAN_MAX_BITS];           ///< Indicates if the corresponding bit is a stuff bit
+    uint8_t tx_bits;                            ///< Number of  bits in the frame
+    uint32_t tx_arbitration_bits;               ///< Number of bits in arbitartion (including stuff bits); the fields are ID A + RTR (standard) or ID A + SRR + IDE + ID B + RTR (extended)
+
+    // Fields set when creating the CAN frame
+    uint32_t crc_rg;                            ///< CRC value (15 bit value)
+    uint32_t last_arbitration_bit;              ///< Bit index of last arbitration bit (always the RTR bit for both IDE = 0 and IDE = 1); may be a stuff bit
+    uint32_t last_dlc_bit;                      ///< Bit index of last bit of DLC field; may be a stuff bit
+    uint32_t last_data_bit;                     ///< Bit index of the last bit of the data field; may be a stuff bit
+    uint32_t last_crc_bit;                      ///< Bit index of last bit of the CRC field; may be a stuff bit
+    uint32_t last_eof_bit;                      ///< Bit index of the last bit of the EOF field; may be a stuff bit
+    bool frame_set;                             ///< True when the frame has been set; may be a stuff bit
+    bool extended;                              ///< True for an extended (29-bit ID, IDE = 1) frame
+
+    // Fields used during creation of the CAN frame
+    uint32_t dominant_bits;                     ///< Dominant bits in a row
+    uint32_t recessive_bits;                    ///< Recessive bits in a row
+    bool stuffing;                              ///< True if stuffing enabled
+    bool crcing;                                ///< True if CRCing enabled
+} can_frame_t;
+
+// Build the stuffed, CRC'd bitstream for a standard (11-bit ID) or extended (29-bit ID) frame.
+// No MicroPython or hardware dependencies, so it can also be built on a host.
+void custom_can_encode_frame(can_frame_t *frame, uint32_t id, bool extended, bool rtr, uint32_t dlc, const uint8_t *data);
+
+#endif // CUSTOM_CAN_FRAME_H
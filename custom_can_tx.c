@@ -0,0 +1,129 @@
+#include "nucleo_custom_can.h"
+
+struct can {
+    can_frame_t can_frame1;                 // CAN frame shared with API
+    can_frame_t can_frame2;                 // CAN frame shared with API
+
+    // Status
+    bool sent;                                  // Indicates if frame sent or not
+
+    struct {
+        uint64_t bitstream_mask;
+        uint64_t bitstream_match;
+        uint32_t n_frame_match_bits;
+        uint32_t n_frame_match_bits_cntdn;
+        uint32_t attack_cntdn;
+        uint32_t dominant_bit_cntdn;
+    } attack_parameters;
+};
+
+static struct can can;
+
+#if defined(CUSTOM_CAN_CAPTURE)
+can_capture_t can_capture;
+#endif
+
+static bool send_frame(const can_frame_t *can_frame, uint32_t retries);
+static bool send_bits(ctr_t bit_end, ctr_t sample_point, struct can *can_p, uint8_t tx_index, const can_frame_t *can_frame);
+
+can_frame_t *custom_can_get_frame(void)
+{
+    return &can.can_frame1;
+}
+
+bool can_send_frame(uint32_t retries)
+{
+    return send_frame(&can.can_frame1, retries);
+}
+
+// Send any frame: the API frame, or one built ahead of time (e.g. from the generated can_static_frames.c) that lives in flash
+bool can_send_frame_ptr(const can_frame_t *frame, uint32_t retries)
+{
+    return send_frame(frame, retries);
+}
+
+static bool send_frame(const can_frame_t *can_frame, uint32_t retries){
+  uint32_t prev_rx = 0;
+    struct can *can_p = &can;
+    uint32_t bitstream = 0;
+    uint8_t tx_index;
+
+#if defined(CUSTOM_CAN_CAPTURE)
+    can_capture.frame = can_frame;
+#endif
+
+    // Look for 11 recessive bits or 10 recessive bits and a dominant
+    uint8_t rx;
+    RESET_CLOCK(0);
+    ctr_t now;
+    ctr_t sample_point = SAMPLE_POINT_OFFSET;
+SOF:
+    for (;;) {
+        rx = GET_CAN_RX();
+        now = GET_CLOCK();
+
+
+        if (prev_rx && !rx) {
+            RESET_CLOCK(0);
+            sample_point = SAMPLE_POINT_OFFSET;
+        }
+        else if (REACHED(now, sample_point)) {
+            ctr_t bit_end = ADVANCE(sample_point, SAMPLE_TO_BIT_END);
+            sample_point = ADVANCE(now, BIT_TIME);
+
+            TRACE_SAMPLE(now, rx);
+            bitstream = (bitstream << 1U) | rx;
+            if ((bitstream & 0x7feU) == 0x7feU) {
+                // 0x7fe = 11111111110
+                // 11 bits, either 10 recessive and dominant = SOF, or 11 recessive
+                // If the last bit was recessive then start index at 0, else start it at 1 to skip SOF
+                tx_index = rx ^ 1U;
+                if (send_bits(bit_end, sample_point, can_p, tx_index, can_frame)) {
+                    if (retries--) {
+                        bitstream = 0; // Make sure we wait until EOF+IFS to trigger next attempt
+                        goto SOF;
+                    }
+                    return false;
+                }
+                return can_p->sent;
+            }
+        }
+        prev_rx = rx;
+    }
+}
+
+static bool send_bits(ctr_t bit_end, ctr_t sample_point, struct can *can_p, uint8_t tx_index, const can_frame_t *frame)
+{
+    ctr_t now;
+    uint32_t rx;
+    uint8_t tx = frame->tx_bitstream[tx_index++];
+    uint8_t cur_tx = tx;
+
+    for (;;) {
+        now = GET_CLOCK();
+        if (REACHED(now, bit_end)) {
+            SET_CAN_TX(tx);
+            TRACE_TX_BIT(now, tx_index - 1U);
+            bit_end = ADVANCE(bit_end, BIT_TIME);
+
+            // The next bit is set up after the time because the critical I/O operation has taken place now
+            cur_tx = tx;
+            tx = frame->tx_bitstream[tx_index++];
+
+            if ((tx_index >= frame->tx_bits)) {
+                can_p->sent = true;
+                return false;
+            }
+        }
+        if (REACHED(now, sample_point)) {
+            rx = GET_CAN_RX();
+            TRACE_SAMPLE(now, rx);
+            if (rx != cur_tx) {
+                    // If arbitration then lost, or an error, then give up and go back to SOF
+                    SET_CAN_TX_REC();
+                    return true;
+            }
+            sample_point = ADVANCE(sample_point, BIT_TIME);
+        }
+    }
+}
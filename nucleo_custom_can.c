@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include "nucleo_custom_can.h"
 #include <py/runtime.h>  // in micropython source
+#if defined(CUSTOM_CAN_STATIC_FRAMES)
+#include "can_static_frames.h"  // generated by tools/can_frame_gen
+#endif
 
 
 typedef struct _can_custom_obj_t {
@@ -8,31 +11,13 @@ typedef struct _can_custom_obj_t {
   uint32_t bit_rate_kbps;
 } can_custom_obj_t;
 
-struct can {
-    can_frame_t can_frame1;                 // CAN frame shared with API
-    can_frame_t can_frame2;                 // CAN frame shared with API
-
-    // Status
-    bool sent;                                  // Indicates if frame sent or not
-
-    struct {
-        uint64_t bitstream_mask;
-        uint64_t bitstream_match;
-        uint32_t n_frame_match_bits;
-        uint32_t n_frame_match_bits_cntdn;
-        uint32_t attack_cntdn;
-        uint32_t dominant_bit_cntdn;
-    } attack_parameters;
-};
-
-static void add_bit(uint8_t bit, can_frame_t *frame);
-
-STATIC bool can_send_frame(uint32_t retries);
+// Defined at the end of this file, after its locals dict
+extern const mp_obj_type_t custom_can_type;
 
 STATIC mp_obj_t custom_can_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
     mp_arg_check_num(n_args, n_kw, 0, MP_OBJ_FUN_ARGS_MAX, true);
 
-    can_custom_obj_t *self = m_new_obj(can_rp2_obj_t);
+    can_custom_obj_t *self = m_new_obj(can_custom_obj_t);
     self->base.type = &custom_can_type;
 
     // Argument parsing
@@ -74,12 +59,13 @@ STATIC mp_obj_t custom_can_make_new(const mp_obj_type_t *type, size_t n_args, si
 }
 
 
-STATIC mp_obj_t custom_can_set_frame(mp_unit_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+STATIC mp_obj_t custom_can_set_frame(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
   static const mp_arg_t allowed_args[] = {
     { MP_QSTR_can_id,     MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0x7ff} },
     { MP_QSTR_data,       MP_ARG_OBJ,                   {.u_obj = mp_const_none} },
     { MP_QSTR_remote,     MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
     { MP_QSTR_dlc,        MP_ARG_KW_ONLY  | MP_ARG_INT,  {.u_int  = 0} },
+    { MP_QSTR_extended,   MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
   };
 
   // Argument parsing
@@ -89,6 +75,7 @@ STATIC mp_obj_t custom_can_set_frame(mp_unit_t n_args, const mp_obj_t *pos_args,
   uint32_t can_id = args[0].u_int;
   mp_obj_t data_obj = args[1].u_obj;
   bool rtr = args[2].u_bool;
+  bool extended = args[4].u_bool;
 
   uint32_t len;
   uint32_t dlc;
@@ -101,6 +88,9 @@ STATIC mp_obj_t custom_can_set_frame(mp_unit_t n_args, const mp_obj_t *pos_args,
       len = copy_mp_bytes(data_obj, data, 8U);
   }
 
+  if (can_id > (extended ? 0x1fffffffU : 0x7ffU)) {
+      nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "CAN ID out of range"));
+  }
   if(rtr && (len > 0)) {
       nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "Remote frames cannot have a payload"));
   }
@@ -111,129 +101,36 @@ STATIC mp_obj_t custom_can_set_frame(mp_unit_t n_args, const mp_obj_t *pos_args,
 
   dlc = len;
 
-  can_frame_t *frame;
-  uint8_t len = rtr ? 0 : (dlc >= 8U ? 8U : dlc);
-
-    frame->tx_bits = 0;
-    frame->crc_rg = 0;
-    frame->stuffing = true;
-    frame->crcing = true;
-    frame->dominant_bits = 0;
-    frame->recessive_bits = 0;
-
-    for (uint32_t i = 0; i < CAN_MAX_BITS; i++) {
-        frame->tx_bitstream[i] = 1U;
-    }
-
-    // ID field is:
-    // {SOF, ID A, RTR, IDE = 0, r0} [Standard]
-
-    // SOF
-    add_bit(0, frame);
-
-    // ID A
-    id_a <<= 21U;
-    for (uint32_t i = 0; i < 11U; i++) {
-        if (id_a & 0x80000000U) {
-            add_bit(1U, frame);
-        }
-        else {
-            add_bit(0, frame);
-        }
-        id_a <<= 1U;
-    }
-
-    // RTR
-    if (rtr) {
-        add_bit(1U, frame);
-    }
-    else {
-        add_bit(0, frame);
-    }
+  can_frame_t *frame = custom_can_get_frame();
+  custom_can_encode_frame(frame, can_id, extended, rtr, dlc, data);
 
-    // The last bit of the arbitration field is the RTR bit if a basic frame
-    frame->last_arbitration_bit = frame->tx_bits - 1U;
+  return mp_const_none;
+}
 
-    add_bit(0, frame);
 
-    // r0
-    add_bit(0, frame);
+// Send `frame` up to `repeat` times, stopping at the first failure; shared by send_frame() and send_static()
+STATIC void send_repeated(const can_frame_t *frame, uint32_t retries, uint32_t repeat)
+{
+#if defined(CUSTOM_CAN_CAPTURE)
+    // Only keep events from this call, so dump_trace() replays them against this frame
+    can_capture.n_events = 0;
+#endif
 
-    // DLC (length)
-    dlc <<= 28U;
-    for (uint32_t i = 0; i < 4U; i++) {
-        if (dlc & 0x80000000U) {
-            add_bit(1U, frame);
-        } else {
-            add_bit(0, frame);
-        }
-        dlc <<= 1U;
-    }
-    frame->last_dlc_bit = frame->tx_bits - 1U;
-
-    // Data
-    for (uint32_t i = 0; i < len; i ++) {
-        uint8_t byte = data[i];
-        for (uint32_t j = 0; j < 8; j++) {
-            if (byte & 0x80U) {
-                add_bit(1U, frame);
-            }
-            else {
-                add_bit(0, frame);
-            }
-            byte <<= 1U;
+    for(;;) {
+        // Disable interrupts around the library call because any interrupts will mess up the timing
+        disable_irq();
+        RESET_CLOCK(0);
+        bool success = can_send_frame_ptr(frame, retries);
+        if (success) {
+            repeat--;
         }
-    }
-    // If the length is 0 then the last data bit is equal to the last DLC bit
-    frame->last_data_bit = frame->tx_bits - 1U;
-
-    // CRC
-    frame->crcing = false;
-    uint32_t crc_rg = frame->crc_rg << 17U;
-    for (uint32_t i = 0; i < 15U; i++) {
-        if (crc_rg & 0x80000000U) {
-            add_bit(1U, frame);
-        } else {
-            add_bit(0, frame);
+        enable_irq();
+        if (!success || repeat == 0) {
+            break;
         }
-        crc_rg <<= 1U;
     }
-    frame->last_crc_bit = frame->tx_bits - 1U;
-
-  //
-    // Bit stuffing is disabled at the end of the CRC field
-    frame->stuffing = false;
-
-    // CRC delimiter
-    add_bit(1U, frame);
-    // ACK slot
-    add_bit(1U, frame);
-    // ACK delimiter
-    add_bit(1U, frame);
-    // EOF
-    add_bit(1U, frame);
-    add_bit(1U, frame);
-    add_bit(1U, frame);
-    add_bit(1U, frame);
-    add_bit(1U, frame);
-    add_bit(1U, frame);
-    add_bit(1U, frame);
-    frame->last_eof_bit = frame->tx_bits - 1U;
-
-    // IFS
-    add_bit(1U, frame);
-    add_bit(1U, frame);
-    add_bit(1U, frame);
-
-    // Set up the matching masks for this CAN frame
-    frame->tx_arbitration_bits = frame->last_arbitration_bit + 1U;
-
-    frame->frame_set = true;
-
-  return mp_const_none;
 }
 
-
 STATIC mp_obj_t custom_can_send_frame(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
 {
     static const mp_arg_t allowed_args[] = {
@@ -256,20 +153,8 @@ STATIC mp_obj_t custom_can_send_frame(mp_uint_t n_args, const mp_obj_t *pos_args
 
     // // Skip transmitting the EOF/IFS so (11 recessive bits) that can send frames back to back
     // frame->tx_bits -= 11U;
-  
-    for(;;) {
-        // Disable interrupts around the library call because any interrupts will mess up the timing
-        disable_irq();
-        RESET_CLOCK(0);
-        bool success = can_send_frame(retries, second);
-        if (success) {
-            repeat--;
-        }
-        enable_irq();
-        if (!success || repeat == 0) {
-            break;
-        }
-    }
+
+    send_repeated(frame, retries, repeat);
 
     // // Put the 11 recessive bits back
     // frame->tx_bits += 11U;
@@ -277,129 +162,95 @@ STATIC mp_obj_t custom_can_send_frame(mp_uint_t n_args, const mp_obj_t *pos_args
     return mp_const_none;
 }
 
-STATIC bool send_bits(ctr_t bit_end, ctr_t sample_point, struct can *can_p, uint8_t tx_index, can_frame_t *can_frame);
-
-STATIC bool can_send_frame(uint32_t retries){
-  uint32_t prev_rx = 0;
-    struct can *can_p = &can;
-    can_frame_t *can_frame = &can_p->can_frame1;
-    uint32_t bitstream = 0;
-    uint8_t tx_index;
-
-    // Look for 11 recessive bits or 10 recessive bits and a dominant
-    uint8_t rx;
-    RESET_CLOCK(0);
-    ctr_t now;
-    ctr_t sample_point = SAMPLE_POINT_OFFSET;
-SOF:
-    for (;;) {
-        rx = GET_CAN_RX();
-        now = GET_CLOCK();
-
-
-        if (prev_rx && !rx) {
-            RESET_CLOCK(0);
-            sample_point = SAMPLE_POINT_OFFSET;
-        }
-        else if (REACHED(now, sample_point)) {
-            ctr_t bit_end = ADVANCE(sample_point, SAMPLE_TO_BIT_END);
-            sample_point = ADVANCE(now, BIT_TIME);
-
-            bitstream = (bitstream << 1U) | rx;
-            if ((bitstream & 0x7feU) == 0x7feU) {
-                // 0x7fe = 11111111110
-                // 11 bits, either 10 recessive and dominant = SOF, or 11 recessive
-                // If the last bit was recessive then start index at 0, else start it at 1 to skip SOF
-                tx_index = rx ^ 1U;
-                if (send_bits(bit_end, sample_point, can_p, tx_index, can_frame)) {
-                    if (retries--) {
-                        bitstream = 0; // Make sure we wait until EOF+IFS to trigger next attempt
-                        goto SOF;
-                    }
-                    return false;
-                }
-                return can_p->sent;
-            }
-        }
-        prev_rx = rx;
-    }
-}
-
-STATIC bool send_bits(ctr_t bit_end, ctr_t sample_point, struct can *can_p, uint8_t tx_index, can_frame_t *frame)
+#if defined(CUSTOM_CAN_STATIC_FRAMES)
+// Send a frame from the generated catalog; no encoding is done and the frame is read from flash
+STATIC mp_obj_t custom_can_send_static(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
 {
-    ctr_t now;
-    uint32_t rx;
-    uint8_t tx = frame->tx_bitstream[tx_index++];
-    uint8_t cur_tx = tx;
-
-    for (;;) {
-        now = GET_CLOCK();
-        if (REACHED(now, bit_end)) {
-            SET_CAN_TX(tx);
-            bit_end = ADVANCE(bit_end, BIT_TIME);
-
-            // The next bit is set up after the time because the critical I/O operation has taken place now
-            cur_tx = tx;
-            tx = frame->tx_bitstream[tx_index++];
-
-            if ((tx_index >= frame->tx_bits)) {
-                can_p->sent = true;
-                return false;
-            }
-        }
-        if (REACHED(now, sample_point)) {
-            rx = GET_CAN_RX();
-            if (rx != cur_tx) {
-                    // If arbitration then lost, or an error, then give up and go back to SOF
-                    SET_CAN_TX_REC();
-                    return true;
-            }
-            sample_point = ADVANCE(sample_point, BIT_TIME);
-        }
+    static const mp_arg_t allowed_args[] = {
+            { MP_QSTR_index,             MP_ARG_REQUIRED | MP_ARG_INT,  {.u_int = 0} },
+            { MP_QSTR_retries,           MP_ARG_KW_ONLY  | MP_ARG_INT,  {.u_int = 0} },
+            { MP_QSTR_repeat,            MP_ARG_KW_ONLY  | MP_ARG_INT,  {.u_int = 1U} }
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    uint32_t index = args[0].u_int;
+    uint32_t retries = args[1].u_int;
+    uint32_t repeat = args[2].u_int;
+
+    if (index >= CAN_STATIC_FRAMES) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "No such static frame"));
     }
-}
+    const can_frame_t *frame = can_static_frames[index];
 
-static void add_raw_bit(uint8_t bit, bool stuff, can_frame_t *frame)
-{
-    // Record the status of the stuff bit for display purposes
-    frame->stuff_bit[frame->tx_bits] = stuff;
-    frame->tx_bitstream[frame->tx_bits++] = bit;
+    send_repeated(frame, retries, repeat);
+
+    return mp_const_none;
 }
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(custom_can_send_static_obj, 2, custom_can_send_static);
+#endif
 
-static void do_crc(uint8_t bitval, can_frame_t *frame)
+#if defined(CUSTOM_CAN_CAPTURE)
+STATIC void trace_write(void *ctx, const char *buf, size_t len)
 {
-    uint32_t bit_14 = (frame->crc_rg & (1U << 14U)) >> 14U;
-    uint32_t crc_nxt = bitval ^ bit_14;
-    frame->crc_rg <<= 1U;
-    frame->crc_rg &= 0x7fffU;
-    if (crc_nxt) {
-        frame->crc_rg ^= 0x4599U;
-    }
+    (void)ctx;
+    mp_print_strn(&mp_plat_print, buf, len, 0, 0, 0);
 }
 
-static void add_bit(uint8_t bit, can_frame_t *frame)
+// Print the capture buffer of the last send_frame() or send_static() as VCD, then clear it;
+// save the REPL output to a .vcd file to view it in GTKWave
+STATIC mp_obj_t custom_can_dump_trace(mp_obj_t self_in)
 {
-    if (frame->crcing) {
-        do_crc(bit, frame);
-    }
-    add_raw_bit(bit, false, frame);
-    if (bit) {
-        frame->recessive_bits++;
-        frame->dominant_bits = 0;
-    } else {
-        frame->dominant_bits++;
-        frame->recessive_bits = 0;
-    }
-    if (frame->stuffing) {
-        if (frame->dominant_bits >= 5U) {
-            add_raw_bit(1U, true, frame);
-            frame->dominant_bits = 0;
-            frame->recessive_bits = 1U;
-        }
-        if (frame->recessive_bits >= 5U) {
-            add_raw_bit(0, true, frame);
-            frame->dominant_bits = 1U;
-            frame->recessive_bits = 0;
-        }
-    }
+    can_custom_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    static can_trace_t trace;
+
+    can_trace_begin(&trace, trace_write, NULL, CLOCK_TICK_PS(self->bit_rate_kbps));
+    can_trace_capture(&trace, &can_capture, BIT_TIME);
+    can_trace_end(&trace, trace.time);
+    can_capture.n_events = 0;
+
+    return mp_const_none;
 }
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(custom_can_dump_trace_obj, custom_can_dump_trace);
+#endif
+
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(custom_can_set_frame_obj, 1, custom_can_set_frame);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(custom_can_send_frame_obj, 1, custom_can_send_frame);
+
+STATIC const mp_map_elem_t custom_can_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR_set_frame), (mp_obj_t)&custom_can_set_frame_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_send_frame), (mp_obj_t)&custom_can_send_frame_obj },
+#if defined(CUSTOM_CAN_STATIC_FRAMES)
+    { MP_OBJ_NEW_QSTR(MP_QSTR_send_static), (mp_obj_t)&custom_can_send_static_obj },
+    CAN_STATIC_FRAMES_DICT_ENTRIES
+#endif
+#if defined(CUSTOM_CAN_CAPTURE)
+    { MP_OBJ_NEW_QSTR(MP_QSTR_dump_trace), (mp_obj_t)&custom_can_dump_trace_obj },
+#endif
+};
+
+STATIC MP_DEFINE_CONST_DICT(custom_can_locals_dict, custom_can_locals_dict_table);
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    custom_can_type,
+    MP_QSTR_CustomCAN,
+    MP_TYPE_FLAG_NONE,
+    make_new, custom_can_make_new,
+    locals_dict, &custom_can_locals_dict
+    );
+
+// `from custom_can import CustomCAN`
+STATIC const mp_map_elem_t custom_can_module_globals_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR___name__), MP_OBJ_NEW_QSTR(MP_QSTR_custom_can) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_CustomCAN), (mp_obj_t)&custom_can_type },
+};
+
+STATIC MP_DEFINE_CONST_DICT(custom_can_module_globals, custom_can_module_globals_table);
+
+const mp_obj_module_t custom_can_user_cmodule = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t *)&custom_can_module_globals,
+};
+
+MP_REGISTER_MODULE(MP_QSTR_custom_can, custom_can_user_cmodule);
@@ -2,6 +2,13 @@
 // MICROPY_HW_CAN1_TX (pin_B9) // and pin_B9's number defined in /ports/stm32/mboot/mphalport.h
 // MICROPY_HW_CAN1_RX (pin_B8) // and pin_B8's number defined in /ports/stm32/mboot/mphalport.h
 
+#ifndef NUCLEO_CUSTOM_CAN_H
+#define NUCLEO_CUSTOM_CAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "custom_can_frame.h"
+
 #define CAN_TX_PIN               (9U)
 #define CAN_RX_PIN               (8U)
 
@@ -9,12 +16,28 @@
 #define BAUD_500KBIT_PRESCALE    (1U)
 #define SAMPLE_POINT_OFFSET      (150U)
 #define SAMPLE_TO_BIT_END        (BIT_TIME - SAMPLE_POINT_OFFSET)
+// Clock tick length in picoseconds, for traces; the prescaler (and so the tick) depends on the bit rate
+#define CLOCK_TICK_PS(bit_rate_kbps)    (1000000000U / ((bit_rate_kbps) * BIT_TIME))
 
 
 // CAN clock controll
+typedef uint32_t ctr_t;
+
 #define REACHED(now, target)     ((now) >= (target))
 #define ADVANCE(now, duration)   ((now) + (duration))
 
+#if defined(CUSTOM_CAN_HOST_SIM)
+// Host builds (see bench/) drive the same TX loop against a simulated clock and bus
+#include "can_sim.h"
+
+#define TICK_PS                             CLOCK_TICK_PS(1000U) // The simulator runs BIT_TIME ticks per bit at 1Mbps
+
+#define GET_CLOCK()                         can_sim_clock()
+#define RESET_CLOCK(t)                      can_sim_reset_clock(t)
+#define GET_CAN_RX()                        can_sim_rx()
+#define SET_CAN_TX(bit)                     can_sim_set_tx(bit)
+#define SET_CAN_TX_REC()                    can_sim_release_tx()
+#else
 #define GET_CLOCK()                         (pwm_hw->slice[CANHACK_PWM].ctr)
 #define RESET_CLOCK(t)                      (pwm_hw->slice[CANHACK_PWM].ctr = (t))
 #define GET_GPIO(gpio)                      (!!((1ul << (gpio)) & sio_hw->gpio_in))
@@ -29,27 +52,30 @@
 
 #define GET_CAN_RX()                        GET_GPIO(CAN_RX_PIN)
 #define SET_CAN_TX(bit)                     SET_GPIO(CAN_TX_PIN, (bit))
+#define SET_CAN_TX_REC()                    SET_CAN_TX(1U)
+#endif
+
+// Trace hooks in the TX loop: the driven bit index and each RX sample.
+// Compiled out on target unless CUSTOM_CAN_CAPTURE is defined, since recording
+// takes a few cycles after each critical I/O operation.
+#if defined(CUSTOM_CAN_HOST_SIM)
+#define TRACE_TX_BIT(now, index)            can_sim_trace_tx_bit(index)
+#define TRACE_SAMPLE(now, rx)               can_sim_trace_sample(rx)
+#elif defined(CUSTOM_CAN_CAPTURE)
+#include "can_trace.h"
+
+extern can_capture_t can_capture;
+
+#define TRACE_TX_BIT(now, index)            can_capture_event(&can_capture, (now), CAN_CAPTURE_TX, (index))
+#define TRACE_SAMPLE(now, rx)               can_capture_event(&can_capture, (now), CAN_CAPTURE_SAMPLE, (rx))
+#else
+#define TRACE_TX_BIT(now, index)
+#define TRACE_SAMPLE(now, rx)
+#endif
+
+// TX loop (custom_can_tx.c)
+can_frame_t *custom_can_get_frame(void);
+bool can_send_frame(uint32_t retries);
+bool can_send_frame_ptr(const can_frame_t *frame, uint32_t retries);
 
-#define CAN_MAX_BITS                        (128U)
-
-typedef struct {
-    uint8_t tx_bitstream[CAN_MAX_BITS];     ///< The bitstream of the CAN frame
-    bool stuff_bit[CAN_MAX_BITS];           ///< Indicates if the corresponding bit is a stuff bit
-    uint8_t tx_bits;                            ///< Number of  bits in the frame
-    uint32_t tx_arbitration_bits;               ///< Number of bits in arbitartion (including stuff bits); the fields are ID A + RTR (standard) or ID A + SRR + IDE + ID B + RTR (extended)
-
-    // Fields set when creating the CAN frame
-    uint32_t crc_rg;                            ///< CRC value (15 bit value)
-    uint32_t last_arbitration_bit;              ///< Bit index of last arbitration bit (always the RTR bit for both IDE = 0 and IDE = 1); may be a stuff bit
-    uint32_t last_dlc_bit;                      ///< Bit index of last bit of DLC field; may be a stuff bit
-    uint32_t last_data_bit;                     ///< Bit index of the last bit of the data field; may be a stuff bit
-    uint32_t last_crc_bit;                      ///< Bit index of last bit of the CRC field; may be a stuff bit
-    uint32_t last_eof_bit;                      ///< Bit index of the last bit of the EOF field; may be a stuff bit
-    bool frame_set;                             ///< True when the frame has been set; may be a stuff bit
-
-    // Fields used during creation of the CAN frame
-    uint32_t dominant_bits;                     ///< Dominant bits in a row
-    uint32_t recessive_bits;                    ///< Recessive bits in a row
-    bool stuffing;                              ///< True if stuffing enabled
-    bool crcing;                                ///< True if CRCing enabled
-} can_frame_t;
+#endif // NUCLEO_CUSTOM_CAN_H
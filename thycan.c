@@ -63,18 +63,22 @@ void thycan_process_queue(CAN_State *state) {
     // Get the front frame in the queue
     CAN_Frame *frame = &state->queue[state->front];
 
+    // Drive SOF one bit from now and sample each bit after it has been driven, as
+    // custom_can_tx.c does; sampling first would compare the idle bus against SOF
     uint32_t now = GET_CLOCK();
-    uint32_t sample_point = now + SAMPLE_POINT_OFFSET;
-    uint32_t bit_end = ADVANCE(sample_point, SAMPLE_TO_BIT_END);
+    uint32_t bit_end = ADVANCE(now, BIT_TIME);
+    uint32_t sample_point = ADVANCE(bit_end, SAMPLE_POINT_OFFSET);
 
     if (send_bits(bit_end, sample_point, frame)) {
         // Frame failed to send, retry or discard
         state->front = (state->front + 1) % CAN_QUEUE_SIZE;
         state->count--;
+        state->sent = false;
     } else {
         // Frame sent successfully
         state->front = (state->front + 1) % CAN_QUEUE_SIZE;
         state->count--;
+        state->sent = true;
     }
 }
 
@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include "stm32f4xx_hal_gpio.h"
 #include "stm32f4xx_hal.h"
+#include "custom_can_frame.h"
 
 /* Timing Constants */
 #define CAN_BITRATE          500000        // CAN bus speed in bps
@@ -22,7 +23,7 @@ typedef struct {
     uint8_t data[8];           // Data payload (up to 8 bytes)
     bool extended;             // Whether the frame uses extended ID
     bool rtr;                  // Remote Transmission Request
-    uint8_t tx_bitstream[128]; // Transmitted bitstream (calculated)
+    uint8_t tx_bitstream[CAN_MAX_BITS]; // Transmitted bitstream (calculated); holds the longest stuffed extended frame
     uint8_t tx_bits;           // Number of bits in the frame
 } CAN_Frame;
 
@@ -32,7 +33,7 @@ typedef struct {
     uint8_t front;                   // Front index of the queue
     uint8_t rear;                    // Rear index of the queue
     uint8_t count;                   // Current number of frames in the queue
-    bool sent;                       // Frame sent flag
+    bool sent;                       // Frame sent flag, set by thycan_process_queue()
     uint32_t timeout;                // Timeout counter
 } CAN_State;
 
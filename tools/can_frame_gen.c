@@ -0,0 +1,274 @@
+// Build-time generator for static CAN frames.
+//
+// Reads a message catalog and writes a C source/header pair of const can_frame_t
+// objects, already stuffed and CRC'd by the same encoder used at runtime. On
+// target the tables end up in flash and are sent with can_send_frame_ptr().
+//
+// Catalog lines are:
+//
+//     <name> <id> std|ext data|remote <dlc> [<byte> ...]
+//
+// with hex or decimal numbers. Data frames list exactly <dlc> bytes; remote
+// frames list none. Blank lines and lines starting with '#' are ignored.
+//
+// usage: can_frame_gen <catalog> <out.c> <out.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "custom_can_frame.h"
+
+#define MAX_MESSAGES             (256U)
+#define MAX_NAME                 (64U)
+
+typedef struct {
+    char name[MAX_NAME];
+    can_frame_t frame;
+    uint32_t id;
+    uint32_t dlc;
+    bool rtr;
+} message_t;
+
+static message_t messages[MAX_MESSAGES];
+static uint32_t n_messages;
+
+static const char *catalog_path;
+static uint32_t lineno;
+
+static void fail(const char *msg, const char *arg)
+{
+    fprintf(stderr, "%s:%u: %s%s\n", catalog_path, lineno, msg, arg ? arg : "");
+    exit(1);
+}
+
+static uint32_t parse_number(const char *token, uint32_t max, const char *what)
+{
+    char *end;
+
+    errno = 0;
+    unsigned long value = strtoul(token, &end, 0);
+    if (errno || *end != '\0' || value > max) {
+        fail(what, token);
+    }
+    return (uint32_t)value;
+}
+
+static bool valid_name(const char *name)
+{
+    if (!isalpha((unsigned char)name[0]) && name[0] != '_') {
+        return false;
+    }
+    for (const char *p = name; *p; p++) {
+        if (!isalnum((unsigned char)*p) && *p != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void parse_line(char *line)
+{
+    char *tokens[4U + 8U + 1U];
+    uint32_t n = 0;
+
+    for (char *tok = strtok(line, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+        if (n == sizeof(tokens) / sizeof(tokens[0])) {
+            fail("too many fields", NULL);
+        }
+        tokens[n++] = tok;
+    }
+    if (n == 0 || tokens[0][0] == '#') {
+        return;
+    }
+    if (n < 5U) {
+        fail("expected <name> <id> std|ext data|remote <dlc> [<byte> ...]", NULL);
+    }
+    if (n_messages == MAX_MESSAGES) {
+        fail("too many messages", NULL);
+    }
+
+    message_t *msg = &messages[n_messages];
+
+    if (strlen(tokens[0]) >= MAX_NAME || !valid_name(tokens[0])) {
+        fail("invalid name ", tokens[0]);
+    }
+    // can_static_frames, CAN_STATIC_FRAMES and CAN_STATIC_FRAMES_* are used by the generated files
+    if (strcmp(tokens[0], "frames") == 0 || strcmp(tokens[0], "FRAMES") == 0 || strncmp(tokens[0], "FRAMES_", 7U) == 0) {
+        fail("reserved name ", tokens[0]);
+    }
+    for (uint32_t i = 0; i < n_messages; i++) {
+        if (strcmp(messages[i].name, tokens[0]) == 0) {
+            fail("duplicate name ", tokens[0]);
+        }
+    }
+    strcpy(msg->name, tokens[0]);
+
+    bool extended = false;
+    if (strcmp(tokens[2], "std") == 0) {
+        extended = false;
+    }
+    else if (strcmp(tokens[2], "ext") == 0) {
+        extended = true;
+    }
+    else {
+        fail("expected std or ext, got ", tokens[2]);
+    }
+    msg->id = parse_number(tokens[1], extended ? 0x1fffffffU : 0x7ffU, "CAN ID out of range: ");
+
+    if (strcmp(tokens[3], "data") == 0) {
+        msg->rtr = false;
+    }
+    else if (strcmp(tokens[3], "remote") == 0) {
+        msg->rtr = true;
+    }
+    else {
+        fail("expected data or remote, got ", tokens[3]);
+    }
+    msg->dlc = parse_number(tokens[4], 8U, "DLC out of range: ");
+
+    uint8_t data[8] = { 0 };
+    uint32_t len = n - 5U;
+    if (len != (msg->rtr ? 0 : msg->dlc)) {
+        fail(msg->rtr ? "remote frames cannot have a payload" : "payload length does not match DLC", NULL);
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)parse_number(tokens[5U + i], 0xffU, "byte out of range: ");
+    }
+
+    custom_can_encode_frame(&msg->frame, msg->id, extended, msg->rtr, msg->dlc, data);
+    n_messages++;
+}
+
+static void write_bits(FILE *f, const char *field, const uint8_t *bits, uint32_t n)
+{
+    fprintf(f, "    .%s = {", field);
+    for (uint32_t i = 0; i < n; i++) {
+        fprintf(f, "%s%u,", (i % 32U) ? " " : "\n        ", bits[i]);
+    }
+    fprintf(f, "\n    },\n");
+}
+
+static void write_source(FILE *f, const char *header)
+{
+    const char *base = strrchr(header, '/');
+
+    fprintf(f, "// Generated by tools/can_frame_gen from %s; do not edit\n\n", catalog_path);
+    fprintf(f, "#include \"%s\"\n", base ? base + 1 : header);
+
+    for (uint32_t i = 0; i < n_messages; i++) {
+        const message_t *msg = &messages[i];
+        const can_frame_t *frame = &msg->frame;
+        uint8_t stuff[CAN_MAX_BITS];
+
+        for (uint32_t j = 0; j < CAN_MAX_BITS; j++) {
+            stuff[j] = frame->stuff_bit[j];
+        }
+
+        fprintf(f, "\n// %s: %s ID 0x%0*x, %s, DLC %u\n", msg->name, frame->extended ? "extended" : "standard",
+                frame->extended ? 8 : 3, msg->id, msg->rtr ? "remote" : "data", msg->dlc);
+        fprintf(f, "const can_frame_t can_static_%s = {\n", msg->name);
+        write_bits(f, "tx_bitstream", frame->tx_bitstream, CAN_MAX_BITS);
+        write_bits(f, "stuff_bit", stuff, frame->tx_bits);
+        fprintf(f, "    .tx_bits = %uU,\n", frame->tx_bits);
+        fprintf(f, "    .tx_arbitration_bits = %uU,\n", frame->tx_arbitration_bits);
+        fprintf(f, "    .crc_rg = 0x%04xU,\n", frame->crc_rg);
+        fprintf(f, "    .last_arbitration_bit = %uU,\n", frame->last_arbitration_bit);
+        fprintf(f, "    .last_dlc_bit = %uU,\n", frame->last_dlc_bit);
+        fprintf(f, "    .last_data_bit = %uU,\n", frame->last_data_bit);
+        fprintf(f, "    .last_crc_bit = %uU,\n", frame->last_crc_bit);
+        fprintf(f, "    .last_eof_bit = %uU,\n", frame->last_eof_bit);
+        fprintf(f, "    .frame_set = true,\n");
+        fprintf(f, "    .extended = %s,\n", frame->extended ? "true" : "false");
+        fprintf(f, "};\n");
+    }
+
+    fprintf(f, "\nconst can_frame_t *const can_static_frames[CAN_STATIC_FRAMES] = {\n");
+    for (uint32_t i = 0; i < n_messages; i++) {
+        fprintf(f, "    &can_static_%s,\n", messages[i].name);
+    }
+    fprintf(f, "};\n");
+}
+
+static void write_header(FILE *f)
+{
+    fprintf(f, "// Generated by tools/can_frame_gen from %s; do not edit\n\n", catalog_path);
+    fprintf(f, "#ifndef CAN_STATIC_FRAMES_H\n#define CAN_STATIC_FRAMES_H\n\n");
+    fprintf(f, "#include \"custom_can_frame.h\"\n\n");
+    fprintf(f, "#define CAN_STATIC_FRAMES                   (%uU)\n\n", n_messages);
+    for (uint32_t i = 0; i < n_messages; i++) {
+        fprintf(f, "#define CAN_STATIC_%s", messages[i].name);
+        for (size_t j = strlen(messages[i].name); j < 24U; j++) {
+            fputc(' ', f);
+        }
+        fprintf(f, " (%uU)\n", i);
+    }
+    fprintf(f, "\n");
+    for (uint32_t i = 0; i < n_messages; i++) {
+        fprintf(f, "extern const can_frame_t can_static_%s;\n", messages[i].name);
+    }
+    fprintf(f, "\n// Indexed by CAN_STATIC_<name>\n");
+    fprintf(f, "extern const can_frame_t *const can_static_frames[CAN_STATIC_FRAMES];\n\n");
+    fprintf(f, "// Locals dict entries exposing each index to Python as STATIC_<name>\n");
+    fprintf(f, "#define CAN_STATIC_FRAMES_DICT_ENTRIES");
+    for (uint32_t i = 0; i < n_messages; i++) {
+        fprintf(f, " \\\n    { MP_OBJ_NEW_QSTR(MP_QSTR_STATIC_%s), MP_OBJ_NEW_SMALL_INT(CAN_STATIC_%s) },",
+                messages[i].name, messages[i].name);
+    }
+    fprintf(f, "\n\n");
+    fprintf(f, "#endif // CAN_STATIC_FRAMES_H\n");
+}
+
+static FILE *open_output(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "cannot create %s\n", path);
+        exit(1);
+    }
+    return f;
+}
+
+static void close_output(FILE *f, const char *path)
+{
+    if (fclose(f)) {
+        fprintf(stderr, "error writing %s\n", path);
+        exit(1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <catalog> <out.c> <out.h>\n", argv[0]);
+        return 1;
+    }
+    catalog_path = argv[1];
+
+    FILE *f = fopen(catalog_path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", catalog_path);
+        return 1;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        parse_line(line);
+    }
+    fclose(f);
+
+    if (n_messages == 0) {
+        fprintf(stderr, "%s: no messages\n", catalog_path);
+        return 1;
+    }
+
+    f = open_output(argv[2]);
+    write_source(f, argv[3]);
+    close_output(f, argv[2]);
+
+    f = open_output(argv[3]);
+    write_header(f);
+    close_output(f, argv[3]);
+    return 0;
+}